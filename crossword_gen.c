@@ -1,25 +1,44 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <ctype.h>
+#include <string.h>
 #include <time.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
 #include "mtrand.h"
 
-#define HALF_BITS 4
 #define OPTION_SYM_BLACKS 1
 #define OPTION_CONNECTED_WHITES 2
 #define OPTION_LINEAR_BLACKS 4
 #define OPTION_ITERATIVE_CHOICES 8
-#define SYMBOL_BLACK '#'
-#define SYMBOL_UNKNOWN '.'
-#define SYMBOL_WHITE '*'
+#define SYMBOLS_MAX 63
+#define SYMBOL_BLACK 0
+#define SYMBOL_UNKNOWN (SYMBOLS_MAX+1)
+#define SYMBOL_WHITE (SYMBOLS_MAX+2)
+#define CODE_BLACK '#'
+#define CODE_INVALID -2
+#define HISTORY_DECAY 0.99999
+#define HISTORY_INC_MAX 1e100
+#define CHECKPOINT_DELAY 600
+#define POLL_NODES 65536
+#define PARTITION_PREFIXES 16
 
 typedef enum {
 	HEURISTIC_WEIGHT,
 	HEURISTIC_WEIGHTED_SHUFFLE,
-	HEURISTIC_SHUFFLE
+	HEURISTIC_SHUFFLE,
+	HEURISTIC_HISTORY
 }
 heuristic_t;
 
+typedef enum {
+	FRAME_CELL,
+	FRAME_END_CELL
+}
+frame_type_t;
+
 typedef struct node_s node_t;
 typedef struct cell_s cell_t;
 
@@ -29,6 +48,7 @@ typedef struct {
 	int leaves_n;
 	int len_min;
 	int len_max;
+	int id;
 }
 letter_t;
 
@@ -55,11 +75,34 @@ typedef struct {
 	letter_t *letter_hor;
 	letter_t *letter_ver;
 	int weight;
+	double history;
 }
 choice_t;
 
+typedef struct {
+	frame_type_t type;
+	cell_t *cell;
+	letter_t *letter;
+	int choices_lo;
+	int choice;
+	int tried;
+	int sym90_bak;
+	int blacks2_row;
+	int blacks2_col;
+	int solutions_n_bak;
+}
+frame_t;
+
 static void expected_parameters(void);
 static int load_dictionary(const char *);
+static int read_dictionary(FILE *, int *);
+static int read_code(FILE *);
+static int upper_code(int);
+static int is_letter_code(int);
+static int add_code(int);
+static int compare_codes(const void *, const void *);
+static void set_node_symbols(node_t *);
+static void put_code(int);
 static node_t *get_node_next(node_t *, int);
 static node_t *set_letter(letter_t *, int);
 static node_t *new_node(void);
@@ -71,32 +114,100 @@ static void set_cell(cell_t *, int, int, int);
 static void set_blacks2_all(int *, int);
 static void set_blacks2(int *, int, int);
 static int solve_grid(cell_t *);
-static int solve_cell(cell_t *, const node_t *, const node_t *, int);
+static cell_t *next_cell(cell_t *);
+static cell_t *solve_cell(cell_t *, const node_t *, const node_t *);
+static int set_choices(cell_t *, const node_t *, const node_t *);
+static cell_t *next_choice(frame_t *);
+static cell_t *back_choice(frame_t *);
+static int set_white(cell_t *);
+static void unset_white(cell_t *);
+static int set_black(cell_t *);
+static void unset_black(cell_t *);
+static void set_black_symbols(cell_t *);
+static void unset_black_symbols(cell_t *);
+static void unset_blacks_n(const cell_t *);
 static int check_letters(const letter_t *, const letter_t *);
 static int check_letter(const letter_t *);
 static int add_choice(letter_t *, letter_t *);
 static void set_choice(choice_t *, letter_t *, letter_t *);
 static int compare_choices(const void *, const void *);
+static int compare_choices_history(const void *, const void *);
+static void raise_history(const cell_t *);
 static void copy_choice(cell_t *, choice_t *);
 static int are_whites_connected(int);
 static void add_marked_cell(cell_t *);
-static int solve_end_cell(letter_t *, cell_t *);
+static cell_t *solve_end_cell(letter_t *, cell_t *);
+static void handle_sigterm(int);
+static void set_letters_all(letter_t *);
+static int save_checkpoint(const cell_t *);
+static cell_t *load_checkpoint(FILE *);
+static int poll_search(const cell_t *);
+static int read_ints(FILE *, int *, int);
+static int read_letter(FILE *, letter_t **);
+static cell_t *read_cell_index(int);
+static int set_partition(void);
+static int check_partition(void);
+static int compare_prefixes(const void *, const void *);
+static int estimate_search(unsigned long);
+static int estimate_nodes(double *, double *, double *, double *);
+static int probe_choice(frame_t *);
+static void share_blacks_max(void);
+static int read_shared_blacks(void);
 static void free_node(node_t *);
 
-static int cells_max, rows_n, cols_n, blacks_min, blacks_max, sym_blacks, connected_whites, linear_blacks, iterative_choices, choices_max, cols_total, choices_size, *blacks2_all, *blacks2_all_cols, *blacks2, *blacks2_cols, cells_n, blacks1_n, choices_hi, sym90, blacks2_n_rows, blacks2_n_cols, whites_n, blacks3_n, partial, hor_len_min, hor_len_max, ver_len_min, ver_len_max, marked_cells_n;
-static double blacks_ratio;
+static int cells_max, rows_n, cols_n, blacks_min, blacks_max, options, sym_blacks, connected_whites, linear_blacks, iterative_choices, choices_max, cols_total, choices_size, *blacks2_all, *blacks2_all_cols, *blacks2, *blacks2_cols, cells_n, blacks1_n, choices_hi, sym90, blacks2_n_rows, blacks2_n_cols, whites_n, blacks3_n, partial, hor_len_min, hor_len_max, ver_len_min, ver_len_max, marked_cells_n, symbols_n, codes[SYMBOLS_MAX+1], solutions_n, result, frames_size, frames_n, letters_n, poll_nodes_n, interrupted, partitions_n, partition_index, partition_depth, partition_enumerating, prefixes_n, prefixes_size, estimate_probes, tune, probing;
+static long checkpoint_delay, probe_visits;
+static time_t checkpoint_time;
+static volatile sig_atomic_t sigterm_received;
+static char *checkpoint_fn, *checkpoint_tmp_fn, *share_fn, *share_tmp_fn;
+static unsigned char *prefixes, *prefix;
+static double blacks_ratio, *histories, *cell_histories, history_inc, probe_weight, probe_nodes;
 static heuristic_t heuristic;
-static letter_t letter_root;
+static letter_t letter_root, **letters_all;
 static node_t *node_root;
 static cell_t *cells, **marked_cells, *first_white;
 static choice_t *choices;
+static frame_t *frames;
 
 int main(int argc, char *argv[]) {
-	int options, r, i;
+	int r, i;
 	unsigned long mtseed;
-	cells_max = 1 << (int)sizeof(int)*HALF_BITS;
-	if (argc != 2) {
-		fprintf(stderr, "Usage: %s <dictionary>\n", *argv);
+	cell_t *cell;
+	cells_max = INT_MAX/(SYMBOLS_MAX+2);
+	checkpoint_delay = CHECKPOINT_DELAY;
+	for (i = 1; i < argc && argv[i+1]; i += 2) {
+		if (!strcmp(argv[i], "--checkpoint")) {
+			checkpoint_fn = argv[i+1];
+		}
+		else if (!strcmp(argv[i], "--checkpoint-delay")) {
+			char *end;
+			checkpoint_delay = strtol(argv[i+1], &end, 10);
+			if (*end || checkpoint_delay < 1) {
+				break;
+			}
+		}
+		else if (!strcmp(argv[i], "--partition")) {
+			char c;
+			if (sscanf(argv[i+1], "%d/%d%c", &partition_index, &partitions_n, &c) != 2 || partitions_n < 1 || partition_index < 0 || partition_index >= partitions_n) {
+				break;
+			}
+		}
+		else if (!strcmp(argv[i], "--share")) {
+			share_fn = argv[i+1];
+		}
+		else if (!strcmp(argv[i], "--estimate") || !strcmp(argv[i], "--tune")) {
+			char c;
+			if (sscanf(argv[i+1], "%d%c", &estimate_probes, &c) != 1 || estimate_probes < 1) {
+				break;
+			}
+			tune = !strcmp(argv[i], "--tune");
+		}
+		else {
+			break;
+		}
+	}
+	if (i == argc || argv[i+1]) {
+		fprintf(stderr, "Usage: %s [ --checkpoint <file> ] [ --checkpoint-delay <seconds> ] [ --partition <index>/<partitions> ] [ --share <file> ] [ --estimate <probes> | --tune <probes> ] <dictionary>\n", *argv);
 		expected_parameters();
 		return EXIT_FAILURE;
 	}
@@ -113,7 +224,7 @@ int main(int argc, char *argv[]) {
 	if (!node_root) {
 		return EXIT_FAILURE;
 	}
-	if (!load_dictionary(argv[1])) {
+	if (!load_dictionary(argv[i])) {
 		free_node(node_root);
 		return EXIT_FAILURE;
 	}
@@ -178,24 +289,183 @@ int main(int argc, char *argv[]) {
 	whites_n = 0;
 	blacks3_n = 0;
 	blacks_ratio = (double)blacks_max/cells_n;
+	solutions_n = 0;
+	if (heuristic == HEURISTIC_HISTORY) {
+		histories = calloc((size_t)(cells_n*(symbols_n+1)), sizeof(double));
+		if (!histories) {
+			fputs("Could not allocate memory for histories\n", stderr);
+			fflush(stderr);
+			free(marked_cells);
+			free(blacks2_all);
+			free(choices);
+			free(cells);
+			free_node(node_root);
+			return EXIT_FAILURE;
+		}
+	}
+	history_inc = 1;
+	frames_size = cells_n+rows_n+cols_n;
+	frames = malloc(sizeof(frame_t)*(size_t)frames_size);
+	if (!frames) {
+		fputs("Could not allocate memory for frames\n", stderr);
+		fflush(stderr);
+		free(histories);
+		free(marked_cells);
+		free(blacks2_all);
+		free(choices);
+		free(cells);
+		free_node(node_root);
+		return EXIT_FAILURE;
+	}
+	frames_n = 0;
 	if (scanf("%lu", &mtseed) != 1) {
 		mtseed = (unsigned long)time(NULL);
 	}
 	smtrand(mtseed);
+	cell = cells+cols_total+1;
+	poll_nodes_n = POLL_NODES;
+	if (share_fn) {
+		share_tmp_fn = malloc(strlen(share_fn)+(size_t)sizeof(int)*3+(size_t)sizeof(long)*3+3);
+		if (!share_tmp_fn) {
+			fputs("Could not allocate memory for share_tmp_fn\n", stderr);
+			fflush(stderr);
+			free(frames);
+			free(histories);
+			free(marked_cells);
+			free(blacks2_all);
+			free(choices);
+			free(cells);
+			free_node(node_root);
+			return EXIT_FAILURE;
+		}
+		sprintf(share_tmp_fn, "%s.%d.%ld", share_fn, partition_index, (long)getpid());
+	}
+	if (partitions_n && !set_partition()) {
+		free(prefixes);
+		free(prefix);
+		free(share_tmp_fn);
+		free(frames);
+		free(histories);
+		free(marked_cells);
+		free(blacks2_all);
+		free(choices);
+		free(cells);
+		free_node(node_root);
+		return EXIT_FAILURE;
+	}
+	if (estimate_probes) {
+		FILE *fd = tune && checkpoint_fn ? fopen(checkpoint_fn, "r"):NULL;
+		if (fd) {
+			fclose(fd);
+			r = 1;
+		}
+		else {
+			r = estimate_search(mtseed);
+		}
+		if (!r || !tune) {
+			free(prefixes);
+			free(prefix);
+			free(share_tmp_fn);
+			free(frames);
+			free(histories);
+			free(marked_cells);
+			free(blacks2_all);
+			free(choices);
+			free(cells);
+			free_node(node_root);
+			return r ? EXIT_SUCCESS:EXIT_FAILURE;
+		}
+	}
+	if (checkpoint_fn) {
+		FILE *fd;
+		letters_n = 0;
+		set_letters_all(&letter_root);
+		letters_all = malloc(sizeof(letter_t *)*(size_t)letters_n);
+		if (!letters_all) {
+			fputs("Could not allocate memory for letters_all\n", stderr);
+			fflush(stderr);
+			free(prefixes);
+			free(prefix);
+			free(share_tmp_fn);
+			free(frames);
+			free(histories);
+			free(marked_cells);
+			free(blacks2_all);
+			free(choices);
+			free(cells);
+			free_node(node_root);
+			return EXIT_FAILURE;
+		}
+		letters_n = 0;
+		set_letters_all(&letter_root);
+		checkpoint_tmp_fn = malloc(strlen(checkpoint_fn)+5);
+		if (!checkpoint_tmp_fn) {
+			fputs("Could not allocate memory for checkpoint_tmp_fn\n", stderr);
+			fflush(stderr);
+			free(letters_all);
+			free(prefixes);
+			free(prefix);
+			free(share_tmp_fn);
+			free(frames);
+			free(histories);
+			free(marked_cells);
+			free(blacks2_all);
+			free(choices);
+			free(cells);
+			free_node(node_root);
+			return EXIT_FAILURE;
+		}
+		sprintf(checkpoint_tmp_fn, "%s.tmp", checkpoint_fn);
+		fd = fopen(checkpoint_fn, "r");
+		if (fd) {
+			cell = load_checkpoint(fd);
+			fclose(fd);
+			if (!cell) {
+				free(checkpoint_tmp_fn);
+				free(letters_all);
+				free(prefixes);
+				free(prefix);
+				free(share_tmp_fn);
+				free(frames);
+				free(histories);
+				free(marked_cells);
+				free(blacks2_all);
+				free(choices);
+				free(cells);
+				free_node(node_root);
+				return EXIT_FAILURE;
+			}
+		}
+		checkpoint_time = time(NULL);
+		signal(SIGTERM, handle_sigterm);
+	}
 	do {
 		printf("CHOICES %d\n", choices_max);
 		fflush(stdout);
-		partial = 0;
-		r = solve_grid(cells+cols_total+1);
+		if (!frames_n) {
+			partial = 0;
+		}
+		r = solve_grid(cell);
+		cell = cells+cols_total+1;
 		++choices_max;
 	}
 	while (partial && !r);
+	if (checkpoint_fn && !interrupted) {
+		remove(checkpoint_fn);
+	}
+	free(checkpoint_tmp_fn);
+	free(letters_all);
+	free(prefixes);
+	free(prefix);
+	free(share_tmp_fn);
+	free(frames);
+	free(histories);
 	free(marked_cells);
 	free(blacks2_all);
 	free(choices);
 	free(cells);
 	free_node(node_root);
-	return EXIT_SUCCESS;
+	return interrupted < 0 ? EXIT_FAILURE:EXIT_SUCCESS;
 }
 
 static void expected_parameters(void) {
@@ -204,7 +474,7 @@ static void expected_parameters(void) {
 	fprintf(stderr, "- Number of columns (>= Number of rows, Number of cells <= %d)\n", cells_max);
 	fputs("- Minimum number of black squares (>= 0)\n", stderr);
 	fputs("- Maximum number of black squares (>= Minimum number of black squares, <= Number of cells)\n", stderr);
-	fprintf(stderr, "- Heuristic (%u: weight, %u: weighted shuffle, %u: shuffle, > %u: none)\n", HEURISTIC_WEIGHT, HEURISTIC_WEIGHTED_SHUFFLE, HEURISTIC_SHUFFLE, HEURISTIC_SHUFFLE);
+	fprintf(stderr, "- Heuristic (%u: weight, %u: weighted shuffle, %u: shuffle, %u: history, > %u: none)\n", HEURISTIC_WEIGHT, HEURISTIC_WEIGHTED_SHUFFLE, HEURISTIC_SHUFFLE, HEURISTIC_HISTORY, HEURISTIC_HISTORY);
 	fputs("- Options (= sum of the below flags)\n", stderr);
 	fprintf(stderr, "\t- Symmetric black squares (0: disabled, %d: enabled)\n", OPTION_SYM_BLACKS);
 	fprintf(stderr, "\t- Connected white squares (0: disabled, %d: enabled)\n", OPTION_CONNECTED_WHITES);
@@ -215,8 +485,7 @@ static void expected_parameters(void) {
 }
 
 static int load_dictionary(const char *fn) {
-	int *symbols = malloc(sizeof(int)*(size_t)(cols_n+1)), len, c;
-	node_t *node;
+	int *symbols = malloc(sizeof(int)*(size_t)(cols_n+1));
 	FILE *fd;
 	if (!symbols) {
 		fputs("Could not allocate memory for symbols\n", stderr);
@@ -230,26 +499,41 @@ static int load_dictionary(const char *fn) {
 		free(symbols);
 		return 0;
 	}
-	node = node_root;
-	len = 0;
-	c = fgetc(fd);
-	while (!feof(fd)) {
-		c = toupper(c);
-		if (isupper(c)) {
-			if (len < cols_n) {
-				symbols[len] = c;
-			}
-			++len;
+	codes[SYMBOL_BLACK] = CODE_BLACK;
+	symbols_n = 0;
+	if (!read_dictionary(fd, symbols)) {
+		fclose(fd);
+		free(symbols);
+		return 0;
+	}
+	fclose(fd);
+	free(symbols);
+	qsort(codes+1, (size_t)symbols_n, sizeof(int), compare_codes);
+	set_node_symbols(node_root);
+	return !blacks_max || get_node_next(node_root, SYMBOL_BLACK);
+}
+
+static int read_dictionary(FILE *fd, int *symbols) {
+	int len = 0, c = read_code(fd);
+	node_t *node = node_root;
+	while (c != EOF) {
+		if (c == CODE_INVALID) {
+			fputs("Invalid UTF-8 sequence in dictionary\n", stderr);
+			fflush(stderr);
+			return 0;
 		}
-		else if (c == '\n') {
+		if (c == '\n') {
 			if ((blacks_max && len <= cols_n) || len == rows_n || len == cols_n) {
 				int i;
+				for (i = 0; i < len; ++i) {
+					if (!add_code(symbols[i])) {
+						return 0;
+					}
+				}
 				symbols[len] = SYMBOL_BLACK;
 				for (i = 0; i <= len; ++i) {
 					node = get_node_next(node, symbols[i]);
 					if (!node) {
-						fclose(fd);
-						free(symbols);
 						return 0;
 					}
 				}
@@ -257,22 +541,158 @@ static int load_dictionary(const char *fn) {
 			len = 0;
 		}
 		else {
-			fprintf(stderr, "Invalid character %c in dictionary\n", c);
-			fflush(stderr);
-			fclose(fd);
-			free(symbols);
-			return 0;
+			if (!is_letter_code(c)) {
+				fprintf(stderr, "Invalid character U+%04X in dictionary\n", (unsigned)c);
+				fflush(stderr);
+				return 0;
+			}
+			if (len < cols_n) {
+				symbols[len] = upper_code(c);
+			}
+			++len;
 		}
-		c = fgetc(fd);
+		c = read_code(fd);
 	}
-	fclose(fd);
-	free(symbols);
 	if (len) {
 		fputs("Unexpected end of dictionary\n", stderr);
 		fflush(stderr);
 		return 0;
 	}
-	return !blacks_max || get_node_next(node_root, SYMBOL_BLACK);
+	return 1;
+}
+
+static int read_code(FILE *fd) {
+	int c = fgetc(fd), code, n, i;
+	if (c == EOF || c < 0x80) {
+		return c;
+	}
+	if (c >= 0xF5 || c < 0xC2) {
+		return CODE_INVALID;
+	}
+	if (c >= 0xF0) {
+		code = c & 0x07;
+		n = 3;
+	}
+	else if (c >= 0xE0) {
+		code = c & 0x0F;
+		n = 2;
+	}
+	else {
+		code = c & 0x1F;
+		n = 1;
+	}
+	for (i = 0; i < n; ++i) {
+		c = fgetc(fd);
+		if (c == EOF || (c & 0xC0) != 0x80) {
+			return CODE_INVALID;
+		}
+		code = code << 6 | (c & 0x3F);
+	}
+	if ((n == 2 && code < 0x800) || (n == 3 && (code < 0x10000 || code > 0x10FFFF))) {
+		return CODE_INVALID;
+	}
+	return code;
+}
+
+static int upper_code(int code) {
+	if (code < 0x80) {
+		return toupper(code);
+	}
+	if ((code >= 0xE0 && code <= 0xFE && code != 0xF7) || (code >= 0x3B1 && code <= 0x3CB && code != 0x3C2) || (code >= 0x430 && code <= 0x44F)) {
+		return code-0x20;
+	}
+	if (code >= 0x450 && code <= 0x45F) {
+		return code-0x50;
+	}
+	if (code == 0x131) {
+		return 'I';
+	}
+	if (code == 0x17F) {
+		return 'S';
+	}
+	if (((code >= 0x100 && code <= 0x137) || (code >= 0x14A && code <= 0x177)) && code & 1) {
+		return code-1;
+	}
+	if (((code >= 0x139 && code <= 0x148) || (code >= 0x179 && code <= 0x17E)) && !(code & 1)) {
+		return code-1;
+	}
+	if (code == 0xFF) {
+		return 0x178;
+	}
+	if (code == 0x3C2) {
+		return 0x3A3;
+	}
+	if (code == 0x3AC) {
+		return 0x386;
+	}
+	if (code >= 0x3AD && code <= 0x3AF) {
+		return code-0x25;
+	}
+	if (code == 0x3CC) {
+		return 0x38C;
+	}
+	if (code >= 0x3CD && code <= 0x3CE) {
+		return code-0x3F;
+	}
+	return code;
+}
+
+static int is_letter_code(int code) {
+	if (code < 0x80) {
+		return isalpha(code);
+	}
+	return (code >= 0xC0 && code <= 0x17F && code != 0xD7 && code != 0xF7) || code == 0x386 || (code >= 0x388 && code <= 0x3CE && code != 0x38B && code != 0x38D && code != 0x3A2) || (code >= 0x400 && code <= 0x45F);
+}
+
+static int add_code(int code) {
+	int i;
+	for (i = symbols_n; i && codes[i] != code; --i);
+	if (i) {
+		return 1;
+	}
+	if (symbols_n == SYMBOLS_MAX) {
+		fprintf(stderr, "Too many letters in dictionary (maximum %d)\n", SYMBOLS_MAX);
+		fflush(stderr);
+		return 0;
+	}
+	++symbols_n;
+	codes[symbols_n] = code;
+	return 1;
+}
+
+static int compare_codes(const void *a, const void *b) {
+	return *(const int *)a-*(const int *)b;
+}
+
+static void set_node_symbols(node_t *node) {
+	int i;
+	for (i = node->letters_n; i--; ) {
+		if (node->letters[i].symbol != SYMBOL_BLACK) {
+			node->letters[i].symbol = (int)((const int *)bsearch(&node->letters[i].symbol, codes+1, (size_t)symbols_n, sizeof(int), compare_codes)-codes);
+			set_node_symbols(node->letters[i].next);
+		}
+	}
+}
+
+static void put_code(int code) {
+	if (code < 0x80) {
+		putchar(code);
+	}
+	else if (code < 0x800) {
+		putchar(0xC0 | code >> 6);
+		putchar(0x80 | (code & 0x3F));
+	}
+	else if (code < 0x10000) {
+		putchar(0xE0 | code >> 12);
+		putchar(0x80 | (code >> 6 & 0x3F));
+		putchar(0x80 | (code & 0x3F));
+	}
+	else {
+		putchar(0xF0 | code >> 18);
+		putchar(0x80 | (code >> 12 & 0x3F));
+		putchar(0x80 | (code >> 6 & 0x3F));
+		putchar(0x80 | (code & 0x3F));
+	}
 }
 
 static node_t *get_node_next(node_t *node, int symbol) {
@@ -378,7 +798,7 @@ static void set_cell(cell_t *cell, int row, int col, int symbol) {
 	cell->hor_len_max = cols_n-col;
 	cell->ver_len_max = rows_n-row;
 	cell->sym180 = cells+(rows_n-row)*cols_total+cols_n-col;
-	cell->sym90 = cells+(col+1)*cols_total+row+1;
+	cell->sym90 = rows_n == cols_n ? cells+(col+1)*cols_total+row+1:NULL;
 	cell->marked = 0;
 	cell->pos = row*cols_n+col+1;
 }
@@ -398,33 +818,128 @@ static void set_blacks2(int *blacks, int size, int n) {
 }
 
 static int solve_grid(cell_t *cell) {
+	result = 0;
+	while (1) {
+		if (cell) {
+			if (sigterm_received) {
+				interrupted = save_checkpoint(cell) ? 1:-1;
+				return -1;
+			}
+			--poll_nodes_n;
+			if (!poll_nodes_n) {
+				poll_nodes_n = POLL_NODES;
+				if (!poll_search(cell)) {
+					result = 1;
+					cell = NULL;
+					continue;
+				}
+			}
+			if (probing) {
+				probe_nodes += probe_weight;
+				++probe_visits;
+			}
+			cell = next_cell(cell);
+		}
+		else {
+			if (!frames_n) {
+				return result;
+			}
+			cell = back_choice(frames+frames_n-1);
+		}
+	}
+}
+
+static cell_t *next_cell(cell_t *cell) {
 	int i;
 	if (cell->row < rows_n) {
 		if (cell->col < cols_n) {
-			return solve_cell(cell, (cell-1)->letter_hor->next, (cell-cols_total)->letter_ver->next, choices_hi);
+			if (partitions_n && cell->pos == partition_depth+1) {
+				i = check_partition();
+				if (i < 1) {
+					result = i;
+					return NULL;
+				}
+			}
+			return solve_cell(cell, (cell-1)->letter_hor->next, (cell-cols_total)->letter_ver->next);
 		}
 		return solve_end_cell((cell-1)->letter_hor->next->letters, cell+2);
 	}
 	if (cell->col < cols_n) {
 		return solve_end_cell((cell-cols_total)->letter_ver->next->letters, cell+1);
 	}
+	if (probing) {
+		result = 0;
+		return NULL;
+	}
 	blacks_max = blacks1_n-1;
 	blacks_ratio = (double)blacks_max/cells_n;
+	++solutions_n;
+	if (share_fn) {
+		share_blacks_max();
+	}
 	printf("BLACK SQUARES %d\n", blacks1_n);
 	for (i = 1; i <= rows_n; ++i) {
 		int j;
-		putchar(cells[i*cols_total+1].symbol);
+		put_code(codes[cells[i*cols_total+1].symbol]);
 		for (j = 2; j <= cols_n; ++j) {
-			printf(" %c", cells[i*cols_total+j].symbol);
+			putchar(' ');
+			put_code(codes[cells[i*cols_total+j].symbol]);
 		}
 		puts("");
 	}
 	fflush(stdout);
-	return blacks_min > blacks_max;
+	result = blacks_min > blacks_max;
+	return NULL;
 }
 
-static int solve_cell(cell_t *cell, const node_t *node_hor, const node_t *node_ver, int choices_lo) {
-	int r, sym90_bak, blacks2_row, blacks2_col, i, j;
+static cell_t *solve_cell(cell_t *cell, const node_t *node_hor, const node_t *node_ver) {
+	int choices_lo = choices_hi, r, i;
+	frame_t *frame;
+	if (!set_choices(cell, node_hor, node_ver)) {
+		result = -1;
+		return NULL;
+	}
+	r = choices_hi-choices_lo;
+	if (!r) {
+		result = 0;
+		return NULL;
+	}
+	if (r > 1) {
+		if (heuristic == HEURISTIC_WEIGHT || heuristic == HEURISTIC_WEIGHTED_SHUFFLE) {
+			qsort(choices+choices_lo, (size_t)r, sizeof(choice_t), compare_choices);
+		}
+		else if (heuristic == HEURISTIC_SHUFFLE) {
+			for (i = choices_lo; i < choices_hi; ++i) {
+				choice_t choice_tmp = choices[i];
+				int j = (int)emtrand((unsigned long)(choices_hi-i))+i;
+				choices[i] = choices[j];
+				choices[j] = choice_tmp;
+			}
+		}
+		else if (heuristic == HEURISTIC_HISTORY) {
+			qsort(choices+choices_lo, (size_t)r, sizeof(choice_t), compare_choices_history);
+		}
+	}
+	frame = frames+frames_n;
+	++frames_n;
+	frame->type = FRAME_CELL;
+	frame->cell = cell;
+	frame->letter = NULL;
+	frame->choices_lo = choices_lo;
+	frame->choice = choices_lo;
+	frame->tried = 0;
+	frame->sym90_bak = sym90;
+	frame->blacks2_row = blacks2[cell->row];
+	frame->blacks2_col = blacks2_cols[cell->col];
+	frame->solutions_n_bak = solutions_n;
+	blacks2_n_rows -= frame->blacks2_row;
+	blacks2_n_cols -= frame->blacks2_col;
+	result = 0;
+	return next_choice(frame);
+}
+
+static int set_choices(cell_t *cell, const node_t *node_hor, const node_t *node_ver) {
+	int i, j;
 	if (sym_blacks) {
 		cell_t *cell_cur;
 		for (cell_cur = cell->sym180; cell_cur->symbol != SYMBOL_UNKNOWN && cell_cur->symbol != SYMBOL_BLACK; --cell_cur);
@@ -448,6 +963,9 @@ static int solve_cell(cell_t *cell, const node_t *node_hor, const node_t *node_v
 			ver_len_min = ver_len_max;
 		}
 	}
+	if (heuristic == HEURISTIC_HISTORY) {
+		cell_histories = histories+(cell->pos-1)*(symbols_n+1);
+	}
 	i = cell->symbol != SYMBOL_WHITE || node_hor->letters->symbol != SYMBOL_BLACK ? 0:1;
 	if (sym90 && cell->sym90 < cell) {
 		for (; i < node_hor->letters_n && node_hor->letters[i].symbol < cell->sym90->symbol; ++i);
@@ -460,13 +978,13 @@ static int solve_cell(cell_t *cell, const node_t *node_hor, const node_t *node_v
 					break;
 				}
 				if (node_hor->letters[i].symbol == node_ver->letters[j].symbol && check_letters(node_hor->letters+i, node_ver->letters+j) && !add_choice(node_hor->letters+i, node_ver->letters+j)) {
-					return -1;
+					return 0;
 				}
 			}
 		}
 		else {
 			if (!i && node_hor->letters->symbol == SYMBOL_BLACK && node_ver->letters->symbol == SYMBOL_BLACK && check_letters(node_hor->letters, node_ver->letters) && !add_choice(node_hor->letters, node_ver->letters)) {
-				return -1;
+				return 0;
 			}
 		}
 	}
@@ -474,154 +992,187 @@ static int solve_cell(cell_t *cell, const node_t *node_hor, const node_t *node_v
 		if (cell->symbol != SYMBOL_BLACK) {
 			for (; i < node_hor->letters_n; ++i) {
 				if (check_letter(node_hor->letters+i) && !add_choice(node_hor->letters+i, node_hor->letters+i)) {
-					return -1;
+					return 0;
 				}
 			}
 		}
 		else {
 			if (!i && node_hor->letters->symbol == SYMBOL_BLACK && check_letter(node_hor->letters) && !add_choice(node_hor->letters, node_hor->letters)) {
-				return -1;
+				return 0;
 			}
 		}
 	}
-	r = choices_hi-choices_lo;
-	if (!r) {
-		return 0;
+	return 1;
+}
+
+static cell_t *next_choice(frame_t *frame) {
+	cell_t *cell = frame->cell;
+	if (probing && !frame->tried && !probe_choice(frame)) {
+		frame->choice = choices_hi;
 	}
-	if (r > 1) {
-		if (heuristic == HEURISTIC_WEIGHT || heuristic == HEURISTIC_WEIGHTED_SHUFFLE) {
-			qsort(choices+choices_lo, (size_t)r, sizeof(choice_t), compare_choices);
-		}
-		else if (heuristic == HEURISTIC_SHUFFLE) {
-			for (i = choices_lo; i < choices_hi; ++i) {
-				choice_t choice_tmp = choices[i];
-				j = (int)emtrand((unsigned long)(choices_hi-i))+i;
-				choices[i] = choices[j];
-				choices[j] = choice_tmp;
+	for (; frame->choice < choices_hi && frame->tried < choices_max && !result; ++frame->choice) {
+		copy_choice(cell, choices+frame->choice);
+		if (cell->letter_hor->symbol != SYMBOL_BLACK ? set_white(cell):set_black(cell)) {
+			if (frame->sym90_bak && cell->sym90 < cell) {
+				sym90 = cell->symbol == cell->sym90->symbol;
 			}
+			frame->solutions_n_bak = solutions_n;
+			return cell+1;
 		}
+		blacks2_n_cols -= blacks2_cols[cell->col];
+		blacks2_n_rows -= blacks2[cell->row];
 	}
-	sym90_bak = sym90;
-	blacks2_row = blacks2[cell->row];
-	blacks2_col = blacks2_cols[cell->col];
-	blacks2_n_rows -= blacks2_row;
-	blacks2_n_cols -= blacks2_col;
-	for (i = choices_lo, j = 0, r = 0; i < choices_hi && j < choices_max && !r; ++i) {
-		copy_choice(cell, choices+i);
-		if (cell->letter_hor->symbol != SYMBOL_BLACK) {
-			blacks2[cell->row] = cell->col+cell->letter_hor->len_max < cols_n ? 1+blacks2_all_cols[cell->col+cell->letter_hor->len_max]:0;
-			blacks2_cols[cell->col] = cell->row+cell->letter_ver->len_max < rows_n ? 1+blacks2_all[cell->row+cell->letter_ver->len_max]:0;
-			blacks2_n_rows += blacks2[cell->row];
-			blacks2_n_cols += blacks2_cols[cell->col];
-			if (blacks1_n+blacks2_n_rows <= blacks_max && blacks1_n+blacks2_n_cols <= blacks_max) {
-				if (connected_whites) {
-					if (!whites_n) {
-						first_white = cell;
-					}
-					if (sym_blacks) {
-						if (cell->sym180 > cell) {
-							whites_n += 2;
-						}
-						else if (cell->sym180 == cell) {
-							++whites_n;
-						}
-					}
-					else {
-						++whites_n;
-					}
-				}
-				cell->symbol = cell->letter_hor->symbol;
-				if (sym_blacks && cell->sym180 > cell) {
-					cell->sym180->symbol = SYMBOL_WHITE;
-				}
-				--cell->letter_hor->leaves_n;
-				--cell->letter_ver->leaves_n;
-				if (sym90_bak && cell->sym90 < cell) {
-					sym90 = cell->symbol == cell->sym90->symbol;
-				}
-				r = solve_grid(cell+1);
-				++j;
-				++cell->letter_ver->leaves_n;
-				++cell->letter_hor->leaves_n;
-				if (sym_blacks && cell->sym180 > cell) {
-					cell->sym180->symbol = SYMBOL_UNKNOWN;
-				}
-				cell->symbol = !sym_blacks || cell->sym180 >= cell ? SYMBOL_UNKNOWN:SYMBOL_WHITE;
-				if (connected_whites) {
-					if (sym_blacks) {
-						if (cell->sym180 > cell) {
-							whites_n -= 2;
-						}
-						else if (cell->sym180 == cell) {
-							--whites_n;
-						}
-					}
-					else {
-						--whites_n;
-					}
-				}
+	blacks2_n_cols += frame->blacks2_col;
+	blacks2_n_rows += frame->blacks2_row;
+	blacks2_cols[cell->col] = frame->blacks2_col;
+	blacks2[cell->row] = frame->blacks2_row;
+	sym90 = frame->sym90_bak;
+	partial |= frame->choice < choices_hi;
+	choices_hi = frame->choices_lo;
+	--frames_n;
+	return NULL;
+}
+
+static cell_t *back_choice(frame_t *frame) {
+	cell_t *cell = frame->cell;
+	if (frame->type == FRAME_END_CELL) {
+		++frame->letter->leaves_n;
+		--frames_n;
+		return NULL;
+	}
+	if (heuristic == HEURISTIC_HISTORY && !probing && !result && solutions_n == frame->solutions_n_bak) {
+		raise_history(cell);
+	}
+	++frame->tried;
+	if (cell->letter_hor->symbol != SYMBOL_BLACK) {
+		unset_white(cell);
+	}
+	else {
+		unset_black(cell);
+	}
+	blacks2_n_cols -= blacks2_cols[cell->col];
+	blacks2_n_rows -= blacks2[cell->row];
+	frame->choice = probing ? choices_hi:frame->choice+1;
+	return next_choice(frame);
+}
+
+static int set_white(cell_t *cell) {
+	blacks2[cell->row] = cell->col+cell->letter_hor->len_max < cols_n ? 1+blacks2_all_cols[cell->col+cell->letter_hor->len_max]:0;
+	blacks2_cols[cell->col] = cell->row+cell->letter_ver->len_max < rows_n ? 1+blacks2_all[cell->row+cell->letter_ver->len_max]:0;
+	blacks2_n_rows += blacks2[cell->row];
+	blacks2_n_cols += blacks2_cols[cell->col];
+	if (blacks1_n+blacks2_n_rows > blacks_max || blacks1_n+blacks2_n_cols > blacks_max) {
+		return 0;
+	}
+	if (connected_whites) {
+		if (!whites_n) {
+			first_white = cell;
+		}
+		if (sym_blacks) {
+			if (cell->sym180 > cell) {
+				whites_n += 2;
+			}
+			else if (cell->sym180 == cell) {
+				++whites_n;
 			}
 		}
 		else {
-			blacks2[cell->row] = blacks2_all_cols[cell->col];
-			blacks2_cols[cell->col] = blacks2_all[cell->row];
-			blacks2_n_rows += blacks2[cell->row];
-			blacks2_n_cols += blacks2_cols[cell->col];
-			++blacks1_n;
-			if (sym_blacks) {
-				if (cell->sym180 > cell) {
-					++blacks3_n;
-				}
-				else if (cell->sym180 < cell) {
-					--blacks3_n;
-				}
-			}
-			if (blacks1_n+blacks2_n_rows <= blacks_max && blacks1_n+blacks2_n_cols <= blacks_max && (!sym_blacks || blacks1_n+blacks3_n <= blacks_max) && (!linear_blacks || (double)blacks1_n <= blacks_ratio*cell->pos)) {
-				if (!sym_blacks || cell->sym180 >= cell) {
-					cell->symbol = SYMBOL_BLACK;
-				}
-				if (sym_blacks && cell->sym180 > cell) {
-					cell->sym180->symbol = SYMBOL_BLACK;
-				}
-				if (are_whites_connected(whites_n)) {
-					--cell->letter_hor->leaves_n;
-					--cell->letter_ver->leaves_n;
-					if (sym90_bak && cell->sym90 < cell) {
-						sym90 = cell->symbol == cell->sym90->symbol;
-					}
-					r = solve_grid(cell+1);
-					++j;
-					++cell->letter_ver->leaves_n;
-					++cell->letter_hor->leaves_n;
-				}
-				if (sym_blacks && cell->sym180 > cell) {
-					cell->sym180->symbol = SYMBOL_UNKNOWN;
-				}
-				if (!sym_blacks || cell->sym180 >= cell) {
-					cell->symbol = SYMBOL_UNKNOWN;
-				}
+			++whites_n;
+		}
+	}
+	cell->symbol = cell->letter_hor->symbol;
+	if (sym_blacks && cell->sym180 > cell) {
+		cell->sym180->symbol = SYMBOL_WHITE;
+	}
+	--cell->letter_hor->leaves_n;
+	--cell->letter_ver->leaves_n;
+	return 1;
+}
+
+static void unset_white(cell_t *cell) {
+	++cell->letter_ver->leaves_n;
+	++cell->letter_hor->leaves_n;
+	if (sym_blacks && cell->sym180 > cell) {
+		cell->sym180->symbol = SYMBOL_UNKNOWN;
+	}
+	cell->symbol = !sym_blacks || cell->sym180 >= cell ? SYMBOL_UNKNOWN:SYMBOL_WHITE;
+	if (connected_whites) {
+		if (sym_blacks) {
+			if (cell->sym180 > cell) {
+				whites_n -= 2;
 			}
-			if (sym_blacks) {
-				if (cell->sym180 > cell) {
-					--blacks3_n;
-				}
-				else if (cell->sym180 < cell) {
-					++blacks3_n;
-				}
+			else if (cell->sym180 == cell) {
+				--whites_n;
 			}
-			--blacks1_n;
 		}
-		blacks2_n_cols -= blacks2_cols[cell->col];
-		blacks2_n_rows -= blacks2[cell->row];
+		else {
+			--whites_n;
+		}
+	}
+}
+
+static int set_black(cell_t *cell) {
+	blacks2[cell->row] = blacks2_all_cols[cell->col];
+	blacks2_cols[cell->col] = blacks2_all[cell->row];
+	blacks2_n_rows += blacks2[cell->row];
+	blacks2_n_cols += blacks2_cols[cell->col];
+	++blacks1_n;
+	if (sym_blacks) {
+		if (cell->sym180 > cell) {
+			++blacks3_n;
+		}
+		else if (cell->sym180 < cell) {
+			--blacks3_n;
+		}
+	}
+	if (blacks1_n+blacks2_n_rows <= blacks_max && blacks1_n+blacks2_n_cols <= blacks_max && (!sym_blacks || blacks1_n+blacks3_n <= blacks_max) && (!linear_blacks || (double)blacks1_n <= blacks_ratio*cell->pos)) {
+		set_black_symbols(cell);
+		if (are_whites_connected(whites_n)) {
+			--cell->letter_hor->leaves_n;
+			--cell->letter_ver->leaves_n;
+			return 1;
+		}
+		unset_black_symbols(cell);
 	}
-	blacks2_n_cols += blacks2_col;
-	blacks2_n_rows += blacks2_row;
-	blacks2_cols[cell->col] = blacks2_col;
-	blacks2[cell->row] = blacks2_row;
-	sym90 = sym90_bak;
-	partial |= i < choices_hi;
-	choices_hi = choices_lo;
-	return r;
+	unset_blacks_n(cell);
+	return 0;
+}
+
+static void unset_black(cell_t *cell) {
+	++cell->letter_ver->leaves_n;
+	++cell->letter_hor->leaves_n;
+	unset_black_symbols(cell);
+	unset_blacks_n(cell);
+}
+
+static void set_black_symbols(cell_t *cell) {
+	if (!sym_blacks || cell->sym180 >= cell) {
+		cell->symbol = SYMBOL_BLACK;
+	}
+	if (sym_blacks && cell->sym180 > cell) {
+		cell->sym180->symbol = SYMBOL_BLACK;
+	}
+}
+
+static void unset_black_symbols(cell_t *cell) {
+	if (sym_blacks && cell->sym180 > cell) {
+		cell->sym180->symbol = SYMBOL_UNKNOWN;
+	}
+	if (!sym_blacks || cell->sym180 >= cell) {
+		cell->symbol = SYMBOL_UNKNOWN;
+	}
+}
+
+static void unset_blacks_n(const cell_t *cell) {
+	if (sym_blacks) {
+		if (cell->sym180 > cell) {
+			--blacks3_n;
+		}
+		else if (cell->sym180 < cell) {
+			++blacks3_n;
+		}
+	}
+	--blacks1_n;
 }
 
 static int check_letters(const letter_t *letter_hor, const letter_t *letter_ver) {
@@ -651,12 +1202,21 @@ static int add_choice(letter_t *letter_hor, letter_t *letter_ver) {
 static void set_choice(choice_t *choice, letter_t *letter_hor, letter_t *letter_ver) {
 	choice->letter_hor = letter_hor;
 	choice->letter_ver = letter_ver;
-	if (heuristic == HEURISTIC_WEIGHT) {
+	if (heuristic == HEURISTIC_WEIGHT || heuristic == HEURISTIC_HISTORY) {
 		choice->weight = letter_hor->symbol != SYMBOL_BLACK ? letter_hor->leaves_n+letter_ver->leaves_n:1;
+		if (heuristic == HEURISTIC_HISTORY) {
+			choice->history = cell_histories[letter_hor->symbol];
+		}
 	}
 	else if (heuristic == HEURISTIC_WEIGHTED_SHUFFLE) {
 		choice->weight = letter_hor->symbol != SYMBOL_BLACK ? (int)emtrand((unsigned long)(letter_hor->leaves_n+letter_ver->leaves_n)):0;
 	}
+	else {
+		choice->weight = 0;
+	}
+	if (heuristic != HEURISTIC_HISTORY) {
+		choice->history = 0;
+	}
 }
 
 static int compare_choices(const void *a, const void *b) {
@@ -667,6 +1227,29 @@ static int compare_choices(const void *a, const void *b) {
 	return choice_b->letter_hor->symbol-choice_a->letter_hor->symbol;
 }
 
+static int compare_choices_history(const void *a, const void *b) {
+	const choice_t *choice_a = (const choice_t *)a, *choice_b = (const choice_t *)b;
+	if (choice_a->history < choice_b->history) {
+		return -1;
+	}
+	if (choice_a->history > choice_b->history) {
+		return 1;
+	}
+	return compare_choices(a, b);
+}
+
+static void raise_history(const cell_t *cell) {
+	histories[(cell->pos-1)*(symbols_n+1)+cell->letter_hor->symbol] += history_inc;
+	history_inc /= HISTORY_DECAY;
+	if (history_inc > HISTORY_INC_MAX) {
+		int i;
+		for (i = cells_n*(symbols_n+1); i--; ) {
+			histories[i] /= HISTORY_INC_MAX;
+		}
+		history_inc /= HISTORY_INC_MAX;
+	}
+}
+
 static void copy_choice(cell_t *cell, choice_t *choice) {
 	cell->letter_hor = choice->letter_hor;
 	cell->letter_ver = choice->letter_ver;
@@ -704,17 +1287,449 @@ static void add_marked_cell(cell_t *cell) {
 	}
 }
 
-static int solve_end_cell(letter_t *letter, cell_t *cell) {
-	if (letter->symbol == SYMBOL_BLACK && letter->leaves_n) {
-		int r;
-		--letter->leaves_n;
-		r = solve_grid(cell);
-		++letter->leaves_n;
-		return r;
+static cell_t *solve_end_cell(letter_t *letter, cell_t *cell) {
+	frame_t *frame;
+	if (letter->symbol != SYMBOL_BLACK || !letter->leaves_n) {
+		result = 0;
+		return NULL;
+	}
+	--letter->leaves_n;
+	frame = frames+frames_n;
+	++frames_n;
+	frame->type = FRAME_END_CELL;
+	frame->cell = cell;
+	frame->letter = letter;
+	frame->choices_lo = choices_hi;
+	frame->choice = choices_hi;
+	frame->tried = 0;
+	frame->sym90_bak = sym90;
+	frame->blacks2_row = 0;
+	frame->blacks2_col = 0;
+	frame->solutions_n_bak = solutions_n;
+	return cell;
+}
+
+static void handle_sigterm(int sig) {
+	(void)sig;
+	sigterm_received = 1;
+}
+
+static void set_letters_all(letter_t *letter) {
+	letter->id = letters_n;
+	if (letters_all) {
+		letters_all[letters_n] = letter;
+	}
+	++letters_n;
+	if (letter->next != node_root || letter == &letter_root) {
+		int i;
+		for (i = 0; i < letter->next->letters_n; ++i) {
+			set_letters_all(letter->next->letters+i);
+		}
+	}
+}
+
+static int save_checkpoint(const cell_t *cell) {
+	unsigned long mtstate[MTRAND_STATE_N];
+	int i;
+	FILE *fd = fopen(checkpoint_tmp_fn, "w");
+	if (!fd) {
+		fputs("Could not open the temporary checkpoint\n", stderr);
+		fflush(stderr);
+		return 0;
+	}
+	fprintf(fd, "%d %d %d %u %d %d %d %d\n", rows_n, cols_n, blacks_min, heuristic, options, letters_n, partition_index, partitions_n);
+	fprintf(fd, "%d %d %d %d %d %d %d %d %d %d %d %d %d %d\n", blacks_max, choices_max, partial, blacks1_n, choices_hi, sym90, blacks2_n_rows, blacks2_n_cols, whites_n, blacks3_n, solutions_n, first_white ? (int)(first_white-cells):-1, (int)(cell-cells), frames_n);
+	for (i = 0; i < rows_n+cols_n; ++i) {
+		fprintf(fd, "%d\n", blacks2[i]);
+	}
+	for (i = 0; i < (rows_n+2)*cols_total; ++i) {
+		fprintf(fd, "%d %d %d\n", cells[i].symbol, cells[i].letter_hor->id, cells[i].letter_ver->id);
+	}
+	for (i = 0; i < letters_n; ++i) {
+		fprintf(fd, "%d\n", letters_all[i]->leaves_n);
+	}
+	for (i = 0; i < choices_hi; ++i) {
+		fprintf(fd, "%d %d %d %.17g\n", choices[i].letter_hor->id, choices[i].letter_ver->id, choices[i].weight, choices[i].history);
+	}
+	for (i = 0; i < frames_n; ++i) {
+		fprintf(fd, "%d %d %d %d %d %d %d %d %d %d\n", frames[i].type, (int)(frames[i].cell-cells), frames[i].letter ? frames[i].letter->id:-1, frames[i].choices_lo, frames[i].choice, frames[i].tried, frames[i].sym90_bak, frames[i].blacks2_row, frames[i].blacks2_col, frames[i].solutions_n_bak);
+	}
+	fprintf(fd, "%.17g\n", history_inc);
+	if (heuristic == HEURISTIC_HISTORY) {
+		for (i = 0; i < cells_n*(symbols_n+1); ++i) {
+			fprintf(fd, "%.17g\n", histories[i]);
+		}
+	}
+	getmtrand(mtstate);
+	for (i = 0; i < MTRAND_STATE_N; ++i) {
+		fprintf(fd, "%lu\n", mtstate[i]);
+	}
+	if (ferror(fd)) {
+		fputs("Could not write the temporary checkpoint\n", stderr);
+		fflush(stderr);
+		fclose(fd);
+		return 0;
 	}
+	if (fclose(fd) || rename(checkpoint_tmp_fn, checkpoint_fn)) {
+		fputs("Could not save the checkpoint\n", stderr);
+		fflush(stderr);
+		return 0;
+	}
+	checkpoint_time = time(NULL);
+	return 1;
+}
+
+static cell_t *load_checkpoint(FILE *fd) {
+	unsigned long mtstate[MTRAND_STATE_N];
+	int header[8], values[14], i;
+	cell_t *cell;
+	if (!read_ints(fd, header, 8) || header[0] != rows_n || header[1] != cols_n || header[2] != blacks_min || (tune ? header[3] < 0 || (header[3] == HEURISTIC_HISTORY && heuristic != HEURISTIC_HISTORY) || (header[4] | OPTION_LINEAR_BLACKS) != (options | OPTION_LINEAR_BLACKS):header[3] != (int)heuristic || header[4] != options) || header[5] != letters_n || header[6] != partition_index || header[7] != partitions_n) {
+		fputs("The checkpoint does not match the grid settings or the dictionary\n", stderr);
+		fflush(stderr);
+		return NULL;
+	}
+	heuristic = (heuristic_t)header[3];
+	options = header[4];
+	linear_blacks = options & OPTION_LINEAR_BLACKS;
+	if (!read_ints(fd, values, 14) || values[0] < blacks_min || values[0] > rows_n*cols_n || values[1] < 1 || values[4] < 0 || values[12] < 0 || values[12] >= (rows_n+2)*cols_total || values[13] < 0 || values[13] > frames_size || !read_ints(fd, blacks2, rows_n+cols_n)) {
+		fputs("Invalid checkpoint state\n", stderr);
+		fflush(stderr);
+		return NULL;
+	}
+	blacks_max = values[0];
+	blacks_ratio = (double)blacks_max/cells_n;
+	choices_max = values[1];
+	partial = values[2];
+	blacks1_n = values[3];
+	sym90 = values[5];
+	blacks2_n_rows = values[6];
+	blacks2_n_cols = values[7];
+	whites_n = values[8];
+	blacks3_n = values[9];
+	solutions_n = values[10];
+	first_white = read_cell_index(values[11]);
+	cell = cells+values[12];
+	frames_n = values[13];
+	for (i = 0; i < (rows_n+2)*cols_total; ++i) {
+		if (fscanf(fd, "%d", &cells[i].symbol) != 1 || !read_letter(fd, &cells[i].letter_hor) || !cells[i].letter_hor || !read_letter(fd, &cells[i].letter_ver) || !cells[i].letter_ver) {
+			fputs("Invalid checkpoint cells\n", stderr);
+			fflush(stderr);
+			return NULL;
+		}
+	}
+	for (i = 0; i < letters_n; ++i) {
+		if (fscanf(fd, "%d", &letters_all[i]->leaves_n) != 1) {
+			fputs("Invalid checkpoint letters\n", stderr);
+			fflush(stderr);
+			return NULL;
+		}
+	}
+	if (values[4] > choices_size) {
+		choice_t *choices_tmp = realloc(choices, sizeof(choice_t)*(size_t)values[4]);
+		if (!choices_tmp) {
+			fputs("Could not reallocate memory for choices\n", stderr);
+			fflush(stderr);
+			return NULL;
+		}
+		choices = choices_tmp;
+		choices_size = values[4];
+	}
+	choices_hi = values[4];
+	for (i = 0; i < choices_hi; ++i) {
+		if (!read_letter(fd, &choices[i].letter_hor) || !choices[i].letter_hor || !read_letter(fd, &choices[i].letter_ver) || !choices[i].letter_ver || fscanf(fd, "%d%lf", &choices[i].weight, &choices[i].history) != 2) {
+			fputs("Invalid checkpoint choices\n", stderr);
+			fflush(stderr);
+			return NULL;
+		}
+	}
+	for (i = 0; i < frames_n; ++i) {
+		int type, cell_idx;
+		if (fscanf(fd, "%d%d", &type, &cell_idx) != 2 || (type != FRAME_CELL && type != FRAME_END_CELL) || !read_cell_index(cell_idx) || !read_letter(fd, &frames[i].letter) || !read_ints(fd, &frames[i].choices_lo, 1) || !read_ints(fd, &frames[i].choice, 1) || !read_ints(fd, &frames[i].tried, 1) || !read_ints(fd, &frames[i].sym90_bak, 1) || !read_ints(fd, &frames[i].blacks2_row, 1) || !read_ints(fd, &frames[i].blacks2_col, 1) || !read_ints(fd, &frames[i].solutions_n_bak, 1) || frames[i].choices_lo < 0 || frames[i].choice < frames[i].choices_lo || frames[i].choice > choices_hi) {
+			fputs("Invalid checkpoint frames\n", stderr);
+			fflush(stderr);
+			return NULL;
+		}
+		frames[i].type = (frame_type_t)type;
+		frames[i].cell = cells+cell_idx;
+	}
+	if (fscanf(fd, "%lf", &history_inc) != 1) {
+		fputs("Invalid checkpoint history\n", stderr);
+		fflush(stderr);
+		return NULL;
+	}
+	if (heuristic == HEURISTIC_HISTORY) {
+		for (i = 0; i < cells_n*(symbols_n+1); ++i) {
+			if (fscanf(fd, "%lf", histories+i) != 1) {
+				fputs("Invalid checkpoint history\n", stderr);
+				fflush(stderr);
+				return NULL;
+			}
+		}
+	}
+	for (i = 0; i < MTRAND_STATE_N; ++i) {
+		if (fscanf(fd, "%lu", mtstate+i) != 1) {
+			fputs("Invalid checkpoint RNG state\n", stderr);
+			fflush(stderr);
+			return NULL;
+		}
+	}
+	setmtrand(mtstate);
+	return cell;
+}
+
+static int poll_search(const cell_t *cell) {
+	if (partition_enumerating || probing) {
+		return 1;
+	}
+	if (checkpoint_fn && difftime(time(NULL), checkpoint_time) >= (double)checkpoint_delay) {
+		save_checkpoint(cell);
+	}
+	if (share_fn) {
+		share_blacks_max();
+	}
+	return blacks_min <= blacks_max;
+}
+
+static int read_ints(FILE *fd, int *values, int n) {
+	int i;
+	for (i = 0; i < n && fscanf(fd, "%d", values+i) == 1; ++i);
+	return i == n;
+}
+
+static int read_letter(FILE *fd, letter_t **letter) {
+	int id;
+	if (fscanf(fd, "%d", &id) != 1 || id < -1 || id >= letters_n) {
+		return 0;
+	}
+	*letter = id >= 0 ? letters_all[id]:NULL;
+	return 1;
+}
+
+static cell_t *read_cell_index(int idx) {
+	return idx >= 0 && idx < (rows_n+2)*cols_total ? cells+idx:NULL;
+}
+
+static int set_partition(void) {
+	int heuristic_bak = (int)heuristic, choices_max_bak = choices_max, linear_blacks_bak = linear_blacks, r, i, j;
+	if (cells_n < 2) {
+		fputs("At least 2 cells are required to partition the search\n", stderr);
+		fflush(stderr);
+		return 0;
+	}
+	prefix = malloc((size_t)cells_n);
+	if (!prefix) {
+		fputs("Could not allocate memory for prefix\n", stderr);
+		fflush(stderr);
+		return 0;
+	}
+	heuristic = HEURISTIC_WEIGHT;
+	choices_max = INT_MAX;
+	linear_blacks = 0;
+	partition_enumerating = 1;
+	for (partition_depth = 1; partition_depth < cells_n; ++partition_depth) {
+		prefixes_n = 0;
+		prefixes_size = 0;
+		r = solve_grid(cells+cols_total+1);
+		if (r < 0) {
+			return 0;
+		}
+		if (!prefixes_n || prefixes_n >= partitions_n*PARTITION_PREFIXES) {
+			break;
+		}
+	}
+	if (partition_depth == cells_n) {
+		--partition_depth;
+	}
+	partition_enumerating = 0;
+	partial = 0;
+	linear_blacks = linear_blacks_bak;
+	choices_max = choices_max_bak;
+	heuristic = (heuristic_t)heuristic_bak;
+	qsort(prefixes, (size_t)prefixes_n, (size_t)partition_depth, compare_prefixes);
+	printf("PARTITION %d/%d DEPTH %d PREFIXES %d\n", partition_index, partitions_n, partition_depth, prefixes_n);
+	fflush(stdout);
+	for (i = partition_index, j = 0; i < prefixes_n; i += partitions_n, ++j) {
+		memmove(prefixes+j*partition_depth, prefixes+i*partition_depth, (size_t)partition_depth);
+	}
+	prefixes_n = j;
+	return 1;
+}
+
+static int check_partition(void) {
+	int i;
+	for (i = 0; i < partition_depth; ++i) {
+		prefix[i] = (unsigned char)cells[(i/cols_n+1)*cols_total+i%cols_n+1].symbol;
+	}
+	if (!partition_enumerating) {
+		return bsearch(prefix, prefixes, (size_t)prefixes_n, (size_t)partition_depth, compare_prefixes) != NULL;
+	}
+	if (prefixes_n == prefixes_size) {
+		unsigned char *prefixes_tmp = realloc(prefixes, (size_t)(prefixes_size+1)*2*(size_t)partition_depth);
+		if (!prefixes_tmp) {
+			fputs("Could not reallocate memory for prefixes\n", stderr);
+			fflush(stderr);
+			return -1;
+		}
+		prefixes = prefixes_tmp;
+		prefixes_size = (prefixes_size+1)*2;
+	}
+	memcpy(prefixes+prefixes_n*partition_depth, prefix, (size_t)partition_depth);
+	++prefixes_n;
 	return 0;
 }
 
+static int compare_prefixes(const void *a, const void *b) {
+	return memcmp(a, b, (size_t)partition_depth);
+}
+
+static int estimate_search(unsigned long mtseed) {
+	heuristic_t heuristic_bak = heuristic;
+	int heuristic_user = heuristic > HEURISTIC_HISTORY ? HEURISTIC_HISTORY+1:(int)heuristic, linear_user = linear_blacks, config_user = heuristic_user*2+(linear_user ? 1:0), config_best = config_user, h, i;
+	double *probes_nodes = malloc(sizeof(double)*(size_t)estimate_probes), nodes, error, seconds[(HEURISTIC_HISTORY+2)*2], seconds_min[(HEURISTIC_HISTORY+2)*2], seconds_max[(HEURISTIC_HISTORY+2)*2];
+	if (!probes_nodes) {
+		fputs("Could not allocate memory for probes_nodes\n", stderr);
+		fflush(stderr);
+		return 0;
+	}
+	for (i = 0; i < (HEURISTIC_HISTORY+2)*2; ++i) {
+		seconds_max[i] = -1;
+	}
+	probing = 1;
+	for (h = HEURISTIC_WEIGHT; h <= HEURISTIC_HISTORY+1; ++h) {
+		if (h != heuristic_user && (!iterative_choices || h == HEURISTIC_HISTORY)) {
+			continue;
+		}
+		heuristic = (heuristic_t)h;
+		for (i = 0; i < 2; ++i) {
+			int config = h*2+i;
+			linear_blacks = i ? OPTION_LINEAR_BLACKS:0;
+			if (!estimate_nodes(probes_nodes, &nodes, &error, seconds+config)) {
+				free(probes_nodes);
+				return 0;
+			}
+			printf("ESTIMATE HEURISTIC %d OPTIONS %d NODES %.3e ERROR %.3e SECONDS %.3e\n", h, (options & ~OPTION_LINEAR_BLACKS) | linear_blacks, nodes, error, seconds[config]);
+			fflush(stdout);
+			seconds_min[config] = seconds[config]*(1-error/nodes);
+			seconds_max[config] = seconds[config]*(1+error/nodes);
+		}
+	}
+	probing = 0;
+	partial = 0;
+	free(probes_nodes);
+	for (i = 0; i < (HEURISTIC_HISTORY+2)*2; ++i) {
+		if (seconds_max[i] >= 0 && seconds_max[i] < seconds_min[config_user] && seconds[i] < seconds[config_best]) {
+			config_best = i;
+		}
+	}
+	heuristic = config_best == config_user ? heuristic_bak:(heuristic_t)(config_best/2);
+	linear_blacks = config_best%2 ? OPTION_LINEAR_BLACKS:0;
+	options = (options & ~OPTION_LINEAR_BLACKS) | linear_blacks;
+	if (tune) {
+		printf("TUNE HEURISTIC %u OPTIONS %d\n", heuristic, options);
+		fflush(stdout);
+	}
+	smtrand(mtseed);
+	return 1;
+}
+
+static int estimate_nodes(double *probes_nodes, double *nodes, double *error, double *seconds) {
+	int choices_max_bak = choices_max, i;
+	clock_t start = clock();
+	for (i = 0; i < estimate_probes; ++i) {
+		probes_nodes[i] = 0;
+	}
+	probe_visits = 0;
+	do {
+		partial = 0;
+		for (i = 0; i < estimate_probes; ++i) {
+			probe_weight = 1;
+			probe_nodes = 0;
+			if (solve_grid(cells+cols_total+1) < 0) {
+				choices_max = choices_max_bak;
+				return 0;
+			}
+			probes_nodes[i] += probe_nodes;
+		}
+		++choices_max;
+	}
+	while (iterative_choices && partial);
+	choices_max = choices_max_bak;
+	*nodes = 0;
+	for (i = 0; i < estimate_probes; ++i) {
+		*nodes += probes_nodes[i];
+	}
+	*nodes /= estimate_probes;
+	*error = 0;
+	for (i = 0; i < estimate_probes; ++i) {
+		*error += (probes_nodes[i]-*nodes)*(probes_nodes[i]-*nodes);
+	}
+	*error = estimate_probes > 1 ? sqrt(*error/(estimate_probes-1)/estimate_probes):*nodes;
+	*seconds = *nodes*(double)(clock()-start)/CLOCKS_PER_SEC/(double)probe_visits;
+	return 1;
+}
+
+static int probe_choice(frame_t *frame) {
+	cell_t *cell = frame->cell;
+	int valid_n = 0, i;
+	for (i = frame->choices_lo; i < choices_hi && valid_n < choices_max; ++i) {
+		copy_choice(cell, choices+i);
+		if (cell->letter_hor->symbol != SYMBOL_BLACK ? set_white(cell):set_black(cell)) {
+			++valid_n;
+			if (!emtrand((unsigned long)valid_n)) {
+				frame->choice = i;
+			}
+			if (cell->letter_hor->symbol != SYMBOL_BLACK) {
+				unset_white(cell);
+			}
+			else {
+				unset_black(cell);
+			}
+		}
+		blacks2_n_cols -= blacks2_cols[cell->col];
+		blacks2_n_rows -= blacks2[cell->row];
+	}
+	if (i < choices_hi) {
+		partial = 1;
+	}
+	probe_weight *= valid_n;
+	return valid_n;
+}
+
+static void share_blacks_max(void) {
+	int blacks = read_shared_blacks();
+	while (solutions_n && blacks_max < blacks-1) {
+		FILE *fd = fopen(share_tmp_fn, "w");
+		if (!fd) {
+			fputs("Could not open the temporary shared file\n", stderr);
+			fflush(stderr);
+			return;
+		}
+		fprintf(fd, "%d\n", blacks_max+1);
+		if (fclose(fd) || rename(share_tmp_fn, share_fn)) {
+			fputs("Could not write the shared file\n", stderr);
+			fflush(stderr);
+			return;
+		}
+		blacks = read_shared_blacks();
+	}
+}
+
+static int read_shared_blacks(void) {
+	int blacks = INT_MAX;
+	FILE *fd = fopen(share_fn, "r");
+	if (fd) {
+		if (fscanf(fd, "%d", &blacks) != 1) {
+			blacks = INT_MAX;
+		}
+		fclose(fd);
+		if (blacks <= blacks_max) {
+			blacks_max = blacks-1;
+			blacks_ratio = (double)blacks_max/cells_n;
+		}
+	}
+	return blacks;
+}
+
 static void free_node(node_t *node) {
 	if (node->letters_n) {
 		int i;
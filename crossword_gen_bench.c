@@ -0,0 +1,371 @@
+#define _POSIX_C_SOURCE 199309L
+#define main crossword_gen_main
+
+int crossword_gen_main(int, char *[]);
+
+#include "crossword_gen.c"
+
+#undef main
+
+#define BENCH_ROWS_N 10
+#define BENCH_COLS_N 15
+#define BENCH_BLACKS_MAX 30
+#define BENCH_WORDS_N 20000
+#define BENCH_SAMPLES_N 4096
+#define BENCH_CHOICES_MAX 26
+#define BENCH_DICTIONARY "crossword_gen_bench.dic"
+
+typedef struct {
+	const node_t *node_hor;
+	const node_t *node_ver;
+	int hor_len_max;
+	int ver_len_max;
+}
+sample_t;
+
+static int generate_dictionary(const char *);
+static int init_grid(const char *);
+static const node_t *random_node(int);
+static void set_samples(void);
+static void set_fill(int, int, int, int, int);
+static void run_bench(const char *, void (*)(long), long);
+static double get_ns(void);
+static double get_cycles(void);
+static void bench_set_choices(long);
+static void bench_check_letters(long);
+static void bench_check_letter(long);
+static void bench_qsort_2(long);
+static void bench_qsort_8(long);
+static void bench_qsort_26(long);
+static void bench_qsort(long, int);
+static void bench_whites_sparse(long);
+static void bench_whites_dense(long);
+static void bench_whites(long, int);
+static void bench_emtrand(long);
+static void bench_load_dictionary(long);
+
+static int bench_failed, fill_whites_n[2];
+static unsigned long bench_sink;
+static const char *bench_fn;
+static sample_t samples[BENCH_SAMPLES_N];
+static letter_t *letters_hor[BENCH_SAMPLES_N], *letters_ver[BENCH_SAMPLES_N];
+static choice_t choices_src[BENCH_SAMPLES_N], choices_dst[BENCH_CHOICES_MAX];
+static cell_t *fill_first_whites[2];
+static int *fills[2];
+
+int main(int argc, char *argv[]) {
+	int generated = 0;
+	if (argc > 2) {
+		fprintf(stderr, "Usage: %s [ <dictionary> ]\n", *argv);
+		fflush(stderr);
+		return EXIT_FAILURE;
+	}
+	if (argc == 2) {
+		bench_fn = argv[1];
+	}
+	else {
+		if (!generate_dictionary(BENCH_DICTIONARY)) {
+			return EXIT_FAILURE;
+		}
+		bench_fn = BENCH_DICTIONARY;
+		generated = 1;
+	}
+	if (!init_grid(bench_fn)) {
+		if (generated) {
+			remove(BENCH_DICTIONARY);
+		}
+		return EXIT_FAILURE;
+	}
+	set_samples();
+	printf("%-32s %12s %12s %12s\n", "KERNEL", "OPS", "NS/OP", "CYCLES/OP");
+	run_bench("set_choices", bench_set_choices, 4000000L);
+	run_bench("check_letters", bench_check_letters, 50000000L);
+	run_bench("check_letter", bench_check_letter, 50000000L);
+	run_bench("qsort compare_choices (2)", bench_qsort_2, 10000000L);
+	run_bench("qsort compare_choices (8)", bench_qsort_8, 4000000L);
+	run_bench("qsort compare_choices (26)", bench_qsort_26, 1000000L);
+	run_bench("are_whites_connected (sparse)", bench_whites_sparse, 200000L);
+	run_bench("are_whites_connected (dense)", bench_whites_dense, 200000L);
+	run_bench("emtrand", bench_emtrand, 50000000L);
+	run_bench("load_dictionary", bench_load_dictionary, 20L);
+	fflush(stdout);
+	free(fills[0]);
+	free(marked_cells);
+	free(choices);
+	free(cells);
+	free_node(node_root);
+	if (generated) {
+		remove(BENCH_DICTIONARY);
+	}
+	return bench_failed ? EXIT_FAILURE:EXIT_SUCCESS;
+}
+
+static int generate_dictionary(const char *fn) {
+	static const char frequencies[] = "EEEEEEEEEEEETTTTTTTTTAAAAAAAAOOOOOOOIIIIIIINNNNNNNSSSSSSRRRRRRHHHHHDDDDLLLLUUUCCCMMMFFYYWWGGPPBVKXQJZ";
+	int i;
+	FILE *fd = fopen(fn, "w");
+	if (!fd) {
+		fputs("Could not create the dictionary\n", stderr);
+		fflush(stderr);
+		return 0;
+	}
+	smtrand(1UL);
+	for (i = 0; i < 26; ++i) {
+		fprintf(fd, "%c\n", 'A'+i);
+	}
+	for (i = 0; i < BENCH_WORDS_N; ++i) {
+		unsigned long len = 2UL+emtrand((unsigned long)(BENCH_COLS_N-1)), j;
+		for (j = 0UL; j < len; ++j) {
+			fputc(frequencies[emtrand((unsigned long)(sizeof(frequencies)-1))], fd);
+		}
+		fputc('\n', fd);
+	}
+	if (fclose(fd)) {
+		fputs("Could not write the dictionary\n", stderr);
+		fflush(stderr);
+		return 0;
+	}
+	return 1;
+}
+
+static int init_grid(const char *fn) {
+	int i;
+	cells_max = INT_MAX/(SYMBOLS_MAX+2);
+	rows_n = BENCH_ROWS_N;
+	cols_n = BENCH_COLS_N;
+	blacks_min = 0;
+	blacks_max = BENCH_BLACKS_MAX;
+	heuristic = HEURISTIC_WEIGHT;
+	node_root = new_node();
+	if (!node_root) {
+		return 0;
+	}
+	if (!load_dictionary(fn)) {
+		free_node(node_root);
+		return 0;
+	}
+	letter_root.symbol = SYMBOL_BLACK;
+	letter_root.next = node_root;
+	choices_max = 1;
+	sort_node(&letter_root, node_root);
+	cols_total = cols_n+2;
+	cells_n = rows_n*cols_n;
+	cells = malloc(sizeof(cell_t)*(size_t)((rows_n+2)*cols_total));
+	choices = malloc(sizeof(choice_t)*(size_t)(node_root->letters_n+1));
+	marked_cells = malloc(sizeof(cell_t *)*(size_t)cells_n);
+	fills[0] = malloc(sizeof(int)*(size_t)(cells_n*2));
+	if (!cells || !choices || !marked_cells || !fills[0]) {
+		fputs("Could not allocate memory for the benchmark\n", stderr);
+		fflush(stderr);
+		free(fills[0]);
+		free(marked_cells);
+		free(choices);
+		free(cells);
+		free_node(node_root);
+		return 0;
+	}
+	fills[1] = fills[0]+cells_n;
+	choices_size = node_root->letters_n+1;
+	choices_hi = 0;
+	set_row(cells, -1, SYMBOL_BLACK);
+	for (i = 1; i <= rows_n; ++i) {
+		set_row(cells+i*cols_total, i-1, SYMBOL_UNKNOWN);
+	}
+	set_row(cells+i*cols_total, i-1, SYMBOL_BLACK);
+	blacks1_n = 0;
+	sym90 = 0;
+	return 1;
+}
+
+static const node_t *random_node(int len) {
+	const node_t *node = node_root;
+	int i;
+	for (i = 0; i < len; ++i) {
+		int j;
+		if (node->letters_n < 2) {
+			break;
+		}
+		j = 1+(int)emtrand((unsigned long)(node->letters_n-1));
+		if (!node->letters[j].leaves_n || node->letters[j].next->letters_n < 2) {
+			break;
+		}
+		node = node->letters[j].next;
+	}
+	return node;
+}
+
+static void set_samples(void) {
+	int i;
+	smtrand(2UL);
+	for (i = 0; i < BENCH_SAMPLES_N; ++i) {
+		const node_t *node;
+		samples[i].node_hor = random_node((int)emtrand(4UL));
+		samples[i].node_ver = random_node((int)emtrand(4UL));
+		samples[i].hor_len_max = 1+(int)emtrand((unsigned long)cols_n);
+		samples[i].ver_len_max = 1+(int)emtrand((unsigned long)rows_n);
+		node = random_node((int)emtrand(4UL));
+		letters_hor[i] = node->letters+emtrand((unsigned long)node->letters_n);
+		node = random_node((int)emtrand(4UL));
+		letters_ver[i] = node->letters+emtrand((unsigned long)node->letters_n);
+		set_choice(choices_src+i, letters_hor[i], letters_ver[i]);
+	}
+	set_fill(0, 3, 1, 10, 1);
+	set_fill(1, 1, 3, 7, 2);
+}
+
+static void set_fill(int fill_idx, int row_factor, int col_factor, int modulo, int blacks_n) {
+	int i;
+	fill_first_whites[fill_idx] = NULL;
+	fill_whites_n[fill_idx] = 0;
+	for (i = 0; i < cells_n; ++i) {
+		fills[fill_idx][i] = (i/cols_n*row_factor+i%cols_n*col_factor)%modulo < blacks_n ? SYMBOL_BLACK:SYMBOL_WHITE;
+		if (fills[fill_idx][i] != SYMBOL_BLACK) {
+			if (!fill_first_whites[fill_idx]) {
+				fill_first_whites[fill_idx] = cells+(i/cols_n+1)*cols_total+i%cols_n+1;
+			}
+			++fill_whites_n[fill_idx];
+		}
+	}
+}
+
+static void run_bench(const char *name, void (*kernel)(long), long ops) {
+	double ns = get_ns(), cycles = get_cycles();
+	kernel(ops);
+	cycles = get_cycles()-cycles;
+	ns = get_ns()-ns;
+	if (cycles > 0) {
+		printf("%-32s %12ld %12.2f %12.2f\n", name, ops, ns/(double)ops, cycles/(double)ops);
+	}
+	else {
+		printf("%-32s %12ld %12.2f %12s\n", name, ops, ns/(double)ops, "-");
+	}
+	fflush(stdout);
+}
+
+static double get_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec*1e9+(double)ts.tv_nsec;
+}
+
+static double get_cycles(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	unsigned lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return (double)hi*4294967296.0+(double)lo;
+#else
+	return 0;
+#endif
+}
+
+static void bench_set_choices(long ops) {
+	cell_t *cell = cells+cols_total*(rows_n/2+1)+cols_n/2+1;
+	long i;
+	for (i = 0; i < ops; ++i) {
+		const sample_t *sample = samples+(i & (BENCH_SAMPLES_N-1));
+		cell->hor_len_max = sample->hor_len_max;
+		cell->ver_len_max = sample->ver_len_max;
+		set_choices(cell, sample->node_hor, sample->node_ver);
+		bench_sink += (unsigned long)choices_hi;
+		choices_hi = 0;
+	}
+}
+
+static void bench_check_letters(long ops) {
+	long i;
+	hor_len_min = 0;
+	ver_len_min = 0;
+	for (i = 0; i < ops; ++i) {
+		int j = (int)(i & (BENCH_SAMPLES_N-1));
+		hor_len_max = samples[j].hor_len_max;
+		ver_len_max = samples[j].ver_len_max;
+		bench_sink += (unsigned long)check_letters(letters_hor[j], letters_ver[j]);
+	}
+}
+
+static void bench_check_letter(long ops) {
+	long i;
+	hor_len_min = 0;
+	ver_len_min = 0;
+	for (i = 0; i < ops; ++i) {
+		int j = (int)(i & (BENCH_SAMPLES_N-1));
+		hor_len_max = samples[j].hor_len_max;
+		ver_len_max = samples[j].ver_len_max;
+		bench_sink += (unsigned long)check_letter(letters_hor[j]);
+	}
+}
+
+static void bench_qsort_2(long ops) {
+	bench_qsort(ops, 2);
+}
+
+static void bench_qsort_8(long ops) {
+	bench_qsort(ops, 8);
+}
+
+static void bench_qsort_26(long ops) {
+	bench_qsort(ops, 26);
+}
+
+static void bench_qsort(long ops, int n) {
+	long i;
+	for (i = 0; i < ops; ++i) {
+		int j = (int)(i & (BENCH_SAMPLES_N-1)), k;
+		for (k = 0; k < n; ++k) {
+			choices_dst[k] = choices_src[(j+k) & (BENCH_SAMPLES_N-1)];
+		}
+		qsort(choices_dst, (size_t)n, sizeof(choice_t), compare_choices);
+		bench_sink += (unsigned long)choices_dst->weight;
+	}
+}
+
+static void bench_whites_sparse(long ops) {
+	bench_whites(ops, 0);
+}
+
+static void bench_whites_dense(long ops) {
+	bench_whites(ops, 1);
+}
+
+static void bench_whites(long ops, int fill_idx) {
+	long i;
+	int j;
+	for (j = 0; j < cells_n; ++j) {
+		cells[(j/cols_n+1)*cols_total+j%cols_n+1].symbol = fills[fill_idx][j];
+	}
+	first_white = fill_first_whites[fill_idx];
+	sym_blacks = 0;
+	for (i = 0; i < ops; ++i) {
+		bench_sink += (unsigned long)are_whites_connected(fill_whites_n[fill_idx]);
+	}
+	for (j = 0; j < cells_n; ++j) {
+		cells[(j/cols_n+1)*cols_total+j%cols_n+1].symbol = SYMBOL_UNKNOWN;
+	}
+}
+
+static void bench_emtrand(long ops) {
+	long i;
+	for (i = 0; i < ops; ++i) {
+		bench_sink += emtrand(26UL);
+	}
+}
+
+static void bench_load_dictionary(long ops) {
+	node_t *node_root_bak = node_root;
+	long i;
+	for (i = 0; i < ops; ++i) {
+		node_root = new_node();
+		if (!node_root) {
+			bench_failed = 1;
+			break;
+		}
+		if (!load_dictionary(bench_fn)) {
+			free_node(node_root);
+			bench_failed = 1;
+			break;
+		}
+		bench_sink += (unsigned long)node_root->letters_n;
+		free_node(node_root);
+	}
+	node_root = node_root_bak;
+}
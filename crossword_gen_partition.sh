@@ -0,0 +1,26 @@
+#!/bin/sh
+if [ $# -ne 2 ]
+then
+	echo "Usage: $0 <processes> <dictionary>" >&2
+	echo "The grid settings are read from the standard input, the output of each process is written to crossword_gen_partition.<index>.out" >&2
+	exit 1
+fi
+PROCESSES=$1
+DICTIONARY=$2
+PARAMETERS=`cat`
+SHARED=crossword_gen_partition.shared
+rm -f $SHARED crossword_gen_partition.*.out
+INDEX=0
+while [ $INDEX -lt $PROCESSES ]
+do
+	echo "$PARAMETERS" | "`dirname "$0"`/crossword_gen" --partition $INDEX/$PROCESSES --share $SHARED "$DICTIONARY" >crossword_gen_partition.$INDEX.out &
+	INDEX=`expr $INDEX + 1`
+done
+wait
+rm -f $SHARED
+BLACKS=`sed -n 's/^BLACK SQUARES //p' crossword_gen_partition.*.out | sort -n | head -n 1`
+if [ -n "$BLACKS" ]
+then
+	echo "BLACK SQUARES $BLACKS"
+	grep -l "^BLACK SQUARES $BLACKS\$" crossword_gen_partition.*.out
+fi
@@ -47,3 +47,19 @@ unsigned long emtrand(unsigned long v) {
 	unsigned long r = mtrand();
 	return (unsigned long)((double)r/((double)0xffffffffUL+1)*(double)v);
 }
+
+void getmtrand(unsigned long *state) {
+	unsigned long i;
+	for (i = 0UL; i < N; ++i) {
+		state[i] = mt[i];
+	}
+	state[N] = mti;
+}
+
+void setmtrand(const unsigned long *state) {
+	unsigned long i;
+	for (i = 0UL; i < N; ++i) {
+		mt[i] = state[i];
+	}
+	mti = state[N];
+}
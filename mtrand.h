@@ -1,3 +1,7 @@
+#define MTRAND_STATE_N 625
+
 void smtrand(unsigned long);
 unsigned long mtrand(void);
 unsigned long emtrand(unsigned long);
+void getmtrand(unsigned long *);
+void setmtrand(const unsigned long *);